@@ -17,5 +17,7 @@ struct Bus {
 
   uint8_t read(uint16_t address);
 
+  bool mapped(uint16_t address) const;
+
   void write(uint16_t address, uint8_t value);
 };
@@ -1,11 +1,53 @@
+#pragma once
+
 #include "bus/bus.h"
 
+#include <atomic>
 #include <cstdint>
 #include <iostream>
+#include <stdexcept>
+
+struct Debugger;
+
+// Raised in strict mode for guest errors the permissive core only logs.
+struct CpuFault : std::runtime_error {
+  enum Kind { UNKNOWN_OPCODE, UNMAPPED_VECTOR };
+  Kind kind;
+  uint16_t address;
+
+  CpuFault(Kind kind, uint16_t address, const std::string &what)
+      : std::runtime_error(what), kind(kind), address(address) {}
+};
 
 struct CPU {
   Bus *bus;
 
+  // Set while an attached debugger wants to see instructions (breakpoints,
+  // single-step, halt request); execute only calls into it when this is set.
+  // debugger_calls counts the CPU thread's calls in flight so the debugger
+  // can wait for them to return before it is destroyed.
+  std::atomic<Debugger *> debugger{nullptr};
+  std::atomic<bool> debug_events{false};
+  std::atomic<int> debugger_calls{0};
+  // True while run() is on the stack.
+  std::atomic<bool> executing{false};
+
+  // Edge coverage: when set, every taken JMP/JSR/RTS/BRK/RTI bumps the
+  // saturating counter coverage[(from >> 1) ^ to], AFL style. An edge's
+  // first hit also appends its index to coverage_edges so consumers can
+  // visit and reset only the touched entries. Both hold COVERAGE_SIZE slots.
+  // coverage_last_from is the source of the most recent transfer.
+  static constexpr size_t COVERAGE_SIZE = 0x10000;
+  uint8_t *coverage = nullptr;
+  uint16_t *coverage_edges = nullptr;
+  size_t coverage_edge_count = 0;
+  uint16_t coverage_last_from = 0;
+  // Throw CpuFault on unknown opcodes and BRK through an unmapped vector.
+  bool strict = false;
+  // run() returns before executing the instruction at this address;
+  // -1 disables the check.
+  int stop_pc = -1;
+
   // registers
   uint8_t AC = 0x00;
   uint16_t PC = 0x0000;
@@ -13,6 +55,7 @@ struct CPU {
   uint8_t IRX = 0x00;
   uint8_t IRY = 0x00;
   uint8_t PS = 0x00;
+  uint64_t total_cycles = 0; // cycles run since power-on
   uint8_t CARRY_FLAG = 1 << 0;
   uint8_t ZERO_FLAG = 1 << 1;
   uint8_t ID_FLAG = 1 << 2;
@@ -61,6 +104,8 @@ struct CPU {
   uint8_t read(uint16_t address);
   void write(uint16_t address, uint8_t value);
 
+  void record_edge(uint16_t from, uint16_t to);
+
   void nop(int &cycles);
 
   void brk(int &cycles);
@@ -111,6 +156,11 @@ struct CPU {
 
   void execute(int cycles);
 
+  // Run instructions until the cycle budget is spent or PC reaches stop_pc,
+  // without logging. Returns the remaining budget: positive after a stop,
+  // zero, or negative when the last instruction overran it.
+  int run(int cycles);
+
   void load_program(const std::vector<uint8_t> &program,
                     uint16_t start_address);
 };
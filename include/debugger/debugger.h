@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <sys/types.h>
+#include <string>
+#include <thread>
+
+struct CPU;
+
+// Disassemble the instruction at address into text, returning its length in
+// bytes.
+int disassemble(CPU &cpu, uint16_t address, std::string &text);
+
+// GDB remote-serial-protocol server on a local Unix-domain socket.
+//
+// The server thread owns the socket. The CPU thread only calls into the
+// debugger when cpu.debug_events is set (a breakpoint exists, a step is in
+// flight or a halt was requested), so an idle debugger costs one atomic
+// load per instruction. With breakpoints set, a miss is a lock-free check of
+// the PC byte map; the mutex is only taken on a hit, a step or a halt
+// request. While halted the CPU thread blocks inside
+// on_instruction and the server thread is free to inspect registers and
+// memory; a CPU thread outside CPU::run can be inspected too while a halt
+// is pending, since it parks before its next instruction. stop() waits for
+// the CPU thread to leave on_instruction, so a running machine can be
+// detached and the debugger destroyed safely.
+struct Debugger {
+  CPU *cpu;
+  std::string path;
+
+  // One byte per PC, read by the CPU thread without the lock and written
+  // by the server thread under it; breakpoint_count mirrors the set bytes.
+  std::array<std::atomic<uint8_t>, 0x10000> breakpoints{};
+  int breakpoint_count = 0;
+  // halt_requested || stepping, readable without the lock.
+  std::atomic<bool> control_pending{false};
+
+  std::mutex mutex;
+  std::condition_variable resumed;
+  std::condition_variable parked;
+  bool halted = false;
+  bool halt_requested = false;
+  bool stepping = false;
+  std::atomic<bool> running{false};
+  bool attached = false;
+  // A halt happened that the client has not been told about yet.
+  bool report_stop = false;
+  // The client was told the CPU stopped while it was outside CPU::run.
+  bool idle_stop = false;
+
+  std::thread server;
+  int listen_fd = -1;
+  int client_fd = -1;
+  int wake_fd[2] = {-1, -1};
+  // Identity of the socket file we bound, so stop() never removes a file
+  // that replaced it.
+  bool socket_created = false;
+  dev_t socket_dev = 0;
+  ino_t socket_ino = 0;
+
+  Debugger(CPU *cpu, std::string path);
+  ~Debugger();
+
+  // Bind the socket and start serving; clients may attach at any time.
+  // Throws std::runtime_error, leaving no descriptor or socket file behind.
+  void start();
+  void stop();
+  // Close descriptors and remove the socket file this process bound.
+  void release();
+
+  // Ask the CPU to stop before its next instruction.
+  void halt();
+
+  // Called by CPU::run before each instruction while debug_events is set.
+  void on_instruction(CPU &cpu);
+
+  void serve();
+  void session();
+  void handle_packet(const std::string &packet);
+  void send_packet(const std::string &payload);
+  void resume(bool step);
+  void update_events();
+  void clear_breakpoints();
+  void wake();
+  void drain_wake();
+};
@@ -1,9 +1,14 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
 struct Device {
   virtual uint8_t read(uint16_t address) = 0;
   virtual void write(uint16_t address, uint8_t data) = 0;
+
+  // Backing storage captured by save states; stateless devices expose none.
+  virtual uint8_t *state_data() { return nullptr; }
+  virtual std::size_t state_size() const { return 0; }
   virtual ~Device() = default;
 };
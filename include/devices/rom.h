@@ -10,4 +10,8 @@ struct Rom : Device {
   uint8_t read(uint16_t address) override;
 
   void write(uint16_t address, uint8_t value) override;
+
+  uint8_t *state_data() override;
+
+  std::size_t state_size() const override;
 };
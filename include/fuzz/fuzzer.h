@@ -0,0 +1,96 @@
+#pragma once
+
+#include "cpu/cpu.h"
+#include "state/savestate.h"
+
+#include <cstdint>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+struct Bus;
+
+// Coverage-guided, in-process fuzzer for guest routines.
+//
+// prepare() installs a harness stub at harness_address:
+//
+//   harness:     JSR entry
+//   harness+3:   JMP harness+3
+//
+// and snapshots the machine with PC at the stub. Each execution restores
+// the snapshot, copies the input to input_address, loads its length into
+// A and runs until the guest returns to harness+3 (done; CPU::stop_pc ends
+// the run there, so the stub's own loop never executes or records
+// coverage), a fault is raised (crash) or cycle_limit is spent (hang).
+struct Fuzzer {
+  enum class Outcome {
+    OK,
+    UNKNOWN_OPCODE,
+    UNMAPPED_VECTOR,
+    UNMAPPED_WRITE,
+    TIMEOUT,
+  };
+
+  struct Finding {
+    Outcome outcome = Outcome::OK;
+    uint16_t pc = 0; // where the fault was raised, or PC at timeout
+    uint16_t from = 0; // source of the last JMP/JSR/RTS/BRK/RTI before it
+    std::string detail;
+    std::vector<uint8_t> input;
+  };
+
+  CPU *cpu;
+  Bus *bus;
+  uint16_t entry;
+  uint16_t input_address;
+  uint16_t harness_address;
+  size_t max_input = 256;
+  int cycle_limit = 100000;
+
+  std::mt19937 rng{0x6502};
+  Snapshot snapshot;
+  std::vector<uint8_t> trace = std::vector<uint8_t>(CPU::COVERAGE_SIZE);
+  std::vector<uint16_t> edges = std::vector<uint16_t>(CPU::COVERAGE_SIZE);
+  // Hit-count buckets seen so far for each edge, kept separately for
+  // completed runs and hangs.
+  std::vector<uint8_t> seen = std::vector<uint8_t>(CPU::COVERAGE_SIZE);
+  std::vector<uint8_t> hang_seen = std::vector<uint8_t>(CPU::COVERAGE_SIZE);
+  std::vector<std::vector<uint8_t>> corpus;
+  // Crashes are unique by (outcome, last transfer source); hangs by new
+  // coverage.
+  // Each list stops growing at max_findings.
+  std::set<std::pair<Outcome, uint16_t>> crash_sites;
+  std::vector<Finding> crashes;
+  std::vector<Finding> hangs;
+  size_t max_findings = 1000;
+  uint64_t executions = 0;
+
+  Fuzzer(CPU *cpu, Bus *bus, uint16_t entry, uint16_t input_address,
+         uint16_t harness_address);
+  // Detaches coverage, strict mode and the stop address from the CPU.
+  ~Fuzzer();
+
+  // The CPU points into this object's buffers once prepared.
+  Fuzzer(const Fuzzer &) = delete;
+  Fuzzer &operator=(const Fuzzer &) = delete;
+
+  // Install the harness and take the reset snapshot; call after the guest
+  // program is loaded.
+  void prepare();
+
+  void add_seed(const std::vector<uint8_t> &input);
+
+  // Run one input from the snapshot, leaving its edge hits in trace.
+  Outcome run_one(const std::vector<uint8_t> &input, Finding &finding);
+
+  // Merge trace into known, reporting whether it hit anything new.
+  bool update_coverage(std::vector<uint8_t> &known);
+  void clear_coverage();
+
+  std::vector<uint8_t> mutate(const std::vector<uint8_t> &input);
+
+  void fuzz(uint64_t iterations);
+};
+
+const char *outcome_name(Fuzzer::Outcome outcome);
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// In-tree LZ4 block format codec (no frame header). Emulator memory is
+// mostly zero pages and repeated code, which greedy LZ4 matching handles
+// well at memcpy-like decode speed.
+
+std::vector<uint8_t> lz4_compress(const uint8_t *src, std::size_t size);
+
+// Decode exactly dst_size bytes; throws std::runtime_error on corrupt input.
+void lz4_decompress(const uint8_t *src, std::size_t src_size, uint8_t *dst,
+                    std::size_t dst_size);
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct Bus;
+struct CPU;
+
+// Versioned binary save state, little-endian throughout:
+//
+//   header   "M65S", u16 version, u16 device count
+//   cpu      u8 A, X, Y, SP, PS, u16 PC, u64 total cycles
+//   device   u16 base, u16 size, u32 raw size, u32 stored size,
+//            u8 encoding (0 raw, 1 LZ4 block), stored bytes
+//   trailer  u32 CRC-32 of every preceding byte
+//
+// Devices are written in Bus attach order and must match the bus they are
+// loaded into; each payload is the device's Device::state_data() window
+// (the reachable 2 KB for Ram). Loading checks the checksum and validates
+// every section before changing the machine; raw sections are copied
+// straight from the input and only LZ4 sections are staged in a scratch
+// buffer.
+constexpr uint16_t SAVE_STATE_VERSION = 1;
+
+void save_state(std::ostream &out, CPU &cpu, Bus &bus, bool compress = true);
+// Replaces path atomically and durably; throws std::runtime_error and
+// leaves any previous file in place on failure.
+void save_state_file(const std::string &path, CPU &cpu, Bus &bus,
+                     bool compress = true);
+
+// Throws std::runtime_error on a corrupt, malformed, newer or mismatched
+// state, leaving the CPU and devices unchanged.
+void load_state(const uint8_t *data, std::size_t size, CPU &cpu, Bus &bus);
+// Maps the file read-only and loads from the mapping.
+void load_state_file(const std::string &path, CPU &cpu, Bus &bus);
+
+// In-memory machine snapshot for fast resets: capture once, then restore
+// with one memcpy per device instead of rebuilding the machine.
+struct Snapshot {
+  uint8_t AC = 0, IRX = 0, IRY = 0, SP = 0, PS = 0;
+  uint16_t PC = 0;
+  uint64_t total_cycles = 0;
+  std::vector<std::vector<uint8_t>> devices;
+
+  void capture(CPU &cpu, Bus &bus);
+  // The bus must have the same devices attached as when captured.
+  void restore(CPU &cpu, Bus &bus) const;
+};
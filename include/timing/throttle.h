@@ -0,0 +1,50 @@
+#pragma once
+
+#include <chrono>
+#include <limits>
+
+struct CPU;
+
+// Paces a CPU against the wall clock in frame-sized slices.
+//
+// Each slice runs one frame's worth of cycles as fast as possible, then
+// sleeps until an absolute deadline. Deadlines advance by a fixed period
+// from the first slice, so oversleeping in one frame is paid back by a
+// shorter sleep in the next instead of accumulating drift. Fractional
+// cycles per frame and instruction overruns are carried into the next
+// slice's budget.
+struct Throttle {
+  using clock = std::chrono::steady_clock;
+
+  static constexpr double NTSC_CLOCK_HZ = 1789773.0;
+  static constexpr double NTSC_FRAME_HZ = 60.0988;
+
+  struct SliceStats {
+    int cycles = 0;                   // cycles the CPU actually ran
+    std::chrono::nanoseconds busy{};  // host time spent emulating
+    std::chrono::nanoseconds period{}; // wall-clock length of a slice
+    // Fraction of the slice left idle for the host; negative when the
+    // host cannot keep up with the configured clock.
+    double headroom = 0.0;
+    bool resynced = false; // fell more than max_lag behind and dropped it
+  };
+
+  CPU *cpu;
+  double clock_hz = NTSC_CLOCK_HZ;
+  double frame_hz = NTSC_FRAME_HZ;
+  // Beyond this much lateness (e.g. after sitting at a breakpoint) the
+  // schedule restarts from now rather than bursting to catch up.
+  std::chrono::milliseconds max_lag{100};
+
+  clock::time_point deadline{};
+  bool started = false;
+  double fraction = 0.0;
+  int debt = 0;
+
+  // Run one frame of cycles (capped at max_cycles) and sleep out the rest
+  // of the frame.
+  SliceStats run_slice(int max_cycles = std::numeric_limits<int>::max());
+
+  // Forget the schedule so the next slice starts a new one.
+  void reset();
+};
@@ -14,6 +14,15 @@ uint8_t Bus::read(uint16_t address) {
   return 0xFF;
 };
 
+bool Bus::mapped(uint16_t address) const {
+  for (auto &map : devices) {
+    if (address >= map.base && address < map.base + map.size) {
+      return true;
+    }
+  }
+  return false;
+}
+
 void Bus::write(uint16_t address, uint8_t value) {
   bool handled = false;
   for (auto &map : devices) {
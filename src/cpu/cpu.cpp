@@ -1,4 +1,5 @@
 #include "cpu/cpu.h"
+#include "debugger/debugger.h"
 
 void CPU::setFlag(uint8_t flag) { PS |= flag; }
 void CPU::clearFlag(uint8_t flag) { PS &= ~flag; }
@@ -14,12 +15,27 @@ void CPU::write(uint16_t address, uint8_t value) {
   bus->write(address, value);
 };
 
+void CPU::record_edge(uint16_t from, uint16_t to) {
+  if (!coverage) {
+    return;
+  }
+  coverage_last_from = from;
+  uint16_t edge = (from >> 1) ^ to;
+  if (coverage[edge] == 0) {
+    coverage_edges[coverage_edge_count++] = edge;
+  }
+  if (coverage[edge] != 0xFF) {
+    coverage[edge]++;
+  }
+}
+
 void CPU::nop(int &cycles) {
   PC++;
   cycles--;
 }
 
 void CPU::brk(int &cycles) {
+  uint16_t from = PC;
   PC++; // advance past BRK
   cycles--;
 
@@ -34,14 +50,20 @@ void CPU::brk(int &cycles) {
   cycles--;
   setFlag(ID_FLAG);
 
+  if (strict && !bus->mapped(0xFFFE)) {
+    throw CpuFault(CpuFault::UNMAPPED_VECTOR, from - 1,
+                   "BRK through unmapped IRQ/BRK vector");
+  }
   uint8_t low = read(0xFFFE);
   cycles--;
   uint8_t high = read(0xFFFF);
   cycles--;
   PC = (static_cast<uint16_t>(high) << 8) | low;
+  record_edge(from, PC);
 };
 
 void CPU::rti(int &cycles) {
+  uint16_t from = PC;
   // Pop status register
   SP++;
   cycles--;
@@ -59,6 +81,7 @@ void CPU::rti(int &cycles) {
   cycles--;
   PC = (static_cast<uint16_t>(high) << 8) | low;
   cycles--;
+  record_edge(from, PC);
 };
 
 void CPU::lda_immediate(int &cycles) {
@@ -277,15 +300,18 @@ void CPU::plp(int &cycles) {
 }
 
 void CPU::jmp_absolute(int &cycles) {
+  uint16_t from = PC;
   uint8_t low = read(PC++);
   cycles--;
   uint8_t high = read(PC++);
   cycles--;
   // little-endian
   PC = (static_cast<uint16_t>(high) << 8) | low;
+  record_edge(from, PC);
 }
 
 void CPU::jmp_indirect(int &cycles) {
+  uint16_t from = PC;
   uint8_t low = read(PC++);
   cycles--;
   uint8_t high = read(PC++);
@@ -301,9 +327,11 @@ void CPU::jmp_indirect(int &cycles) {
 
   // little-endian
   PC = (static_cast<uint16_t>(indirect_high) << 8) | indirect_low;
+  record_edge(from, PC);
 }
 
 void CPU::jsr(int &cycles) {
+  uint16_t from = PC;
   uint8_t low = read(PC++);
   cycles--;
   uint8_t high = read(PC++);
@@ -316,9 +344,11 @@ void CPU::jsr(int &cycles) {
   cycles--;
   PC = (static_cast<uint16_t>(high) << 8) | low;
   cycles--;
+  record_edge(from, PC);
 }
 
 void CPU::rts(int &cycles) {
+  uint16_t from = PC;
   // Pop low byte
   SP++;
   cycles--;
@@ -332,6 +362,7 @@ void CPU::rts(int &cycles) {
   PC = (static_cast<uint16_t>(high) << 8) | low;
   PC++; // RTS returns to address after JSR
   cycles--;
+  record_edge(from, PC);
 }
 
 void CPU::load_program(std::vector<uint8_t> const &program,
@@ -346,7 +377,35 @@ void CPU::load_program(std::vector<uint8_t> const &program,
 
 void CPU::execute(int cycles) {
   std::cout << "Starting execution for " << cycles << " cycles." << "\n";
-  while (cycles > 0) {
+  cycles = run(cycles);
+  std::cout << "Finishing execution for " << cycles << " cycles." << "\n";
+}
+
+namespace {
+
+// Clears CPU::executing however run() exits; bus writes can throw.
+struct ExecutingScope {
+  std::atomic<bool> &executing;
+  explicit ExecutingScope(std::atomic<bool> &executing)
+      : executing(executing) {
+    executing.store(true);
+  }
+  ~ExecutingScope() { executing.store(false); }
+};
+
+} // namespace
+
+int CPU::run(int cycles) {
+  ExecutingScope scope(executing);
+  int budget = cycles;
+  while (cycles > 0 && PC != stop_pc) {
+    if (debug_events.load()) {
+      debugger_calls.fetch_add(1);
+      if (Debugger *attached = debugger.load()) {
+        attached->on_instruction(*this);
+      }
+      debugger_calls.fetch_sub(1, std::memory_order_release);
+    }
     uint8_t opcode = read(PC++);
     cycles--;
     switch (opcode) {
@@ -423,10 +482,15 @@ void CPU::execute(int cycles) {
       rts(cycles);
     } break;
     default:
+      if (strict) {
+        throw CpuFault(CpuFault::UNKNOWN_OPCODE, PC - 1,
+                       "Unknown opcode: " + std::to_string(opcode));
+      }
       std::cout << "Unknown opcode: " << std::hex << +opcode << std::dec
                 << "\n";
       break;
     }
   }
-  std::cout << "Finishing execution for " << cycles << " cycles." << "\n";
+  total_cycles += budget - cycles;
+  return cycles;
 }
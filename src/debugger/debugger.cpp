@@ -0,0 +1,642 @@
+#include "debugger/debugger.h"
+#include "cpu/cpu.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <poll.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+const char *HEX = "0123456789abcdef";
+
+std::string to_hex(uint8_t value) {
+  return {HEX[value >> 4], HEX[value & 0x0F]};
+}
+
+std::string to_hex(const std::string &text) {
+  std::string out;
+  for (unsigned char c : text) {
+    out += to_hex(static_cast<uint8_t>(c));
+  }
+  return out;
+}
+
+std::string from_hex(const std::string &hex) {
+  std::string out;
+  for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+    out += static_cast<char>(std::stoul(hex.substr(i, 2), nullptr, 16));
+  }
+  return out;
+}
+
+void send_all(int fd, const std::string &data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+#ifdef MSG_NOSIGNAL
+    ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+#else
+    ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, 0);
+#endif
+    if (n <= 0) {
+      return;
+    }
+    sent += n;
+  }
+}
+
+// Register order exposed through g/G/p/P: A, X, Y, SP, PS, PC (little-endian).
+uint8_t *register_ptr(CPU &cpu, int index) {
+  switch (index) {
+  case 0:
+    return &cpu.AC;
+  case 1:
+    return &cpu.IRX;
+  case 2:
+    return &cpu.IRY;
+  case 3:
+    return &cpu.SP;
+  case 4:
+    return &cpu.PS;
+  }
+  return nullptr;
+}
+
+std::string read_register(CPU &cpu, int index) {
+  if (index == 5) {
+    return to_hex(static_cast<uint8_t>(cpu.PC & 0xFF)) +
+           to_hex(static_cast<uint8_t>(cpu.PC >> 8));
+  }
+  uint8_t *reg = register_ptr(cpu, index);
+  return reg ? to_hex(*reg) : "";
+}
+
+bool write_register(CPU &cpu, int index, const std::string &hex) {
+  std::string bytes = from_hex(hex);
+  if (index == 5 && bytes.size() >= 2) {
+    cpu.PC = static_cast<uint8_t>(bytes[0]) |
+             (static_cast<uint16_t>(static_cast<uint8_t>(bytes[1])) << 8);
+    return true;
+  }
+  uint8_t *reg = register_ptr(cpu, index);
+  if (!reg || bytes.empty()) {
+    return false;
+  }
+  *reg = static_cast<uint8_t>(bytes[0]);
+  return true;
+}
+
+} // namespace
+
+int disassemble(CPU &cpu, uint16_t address, std::string &text) {
+  uint8_t opcode = cpu.read(address);
+  uint8_t low = cpu.read(address + 1);
+  uint8_t high = cpu.read(address + 2);
+  std::string zp = "$" + to_hex(low);
+  std::string abs = "$" + to_hex(high) + to_hex(low);
+
+  switch (opcode) {
+  case CPU::LDA_IMMEDIATE:
+    text = "LDA #" + zp;
+    return 2;
+  case CPU::LDX_IMMEDIATE:
+    text = "LDX #" + zp;
+    return 2;
+  case CPU::LDY_IMMEDIATE:
+    text = "LDY #" + zp;
+    return 2;
+  case CPU::STA_ZP:
+    text = "STA " + zp;
+    return 2;
+  case CPU::STA_ABS:
+    text = "STA " + abs;
+    return 3;
+  case CPU::STX_ZP:
+    text = "STX " + zp;
+    return 2;
+  case CPU::STY_ZP:
+    text = "STY " + zp;
+    return 2;
+  case CPU::AND_IMMEDIATE:
+    text = "AND #" + zp;
+    return 2;
+  case CPU::ORA_IMMEDIATE:
+    text = "ORA #" + zp;
+    return 2;
+  case CPU::EOR_IMMEDIATE:
+    text = "EOR #" + zp;
+    return 2;
+  case CPU::INC_ZP:
+    text = "INC " + zp;
+    return 2;
+  case CPU::DEC_ZP:
+    text = "DEC " + zp;
+    return 2;
+  case CPU::JMP_ABSOLUTE:
+    text = "JMP " + abs;
+    return 3;
+  case CPU::JMP_INDIRECT:
+    text = "JMP (" + abs + ")";
+    return 3;
+  case CPU::JSR:
+    text = "JSR " + abs;
+    return 3;
+  }
+
+  const char *implied = nullptr;
+  switch (opcode) {
+  case CPU::TAX: implied = "TAX"; break;
+  case CPU::TAY: implied = "TAY"; break;
+  case CPU::TXA: implied = "TXA"; break;
+  case CPU::TYA: implied = "TYA"; break;
+  case CPU::TSX: implied = "TSX"; break;
+  case CPU::TXS: implied = "TXS"; break;
+  case CPU::PHA: implied = "PHA"; break;
+  case CPU::PHP: implied = "PHP"; break;
+  case CPU::PLA: implied = "PLA"; break;
+  case CPU::PLP: implied = "PLP"; break;
+  case CPU::INX: implied = "INX"; break;
+  case CPU::INY: implied = "INY"; break;
+  case CPU::DEX: implied = "DEX"; break;
+  case CPU::DEY: implied = "DEY"; break;
+  case CPU::RTS: implied = "RTS"; break;
+  case CPU::CLC: implied = "CLC"; break;
+  case CPU::CLD: implied = "CLD"; break;
+  case CPU::CLI: implied = "CLI"; break;
+  case CPU::CLV: implied = "CLV"; break;
+  case CPU::SEC: implied = "SEC"; break;
+  case CPU::SED: implied = "SED"; break;
+  case CPU::SEI: implied = "SEI"; break;
+  case CPU::BRK: implied = "BRK"; break;
+  case CPU::NOP: implied = "NOP"; break;
+  case CPU::RTI: implied = "RTI"; break;
+  }
+  text = implied ? implied : ".byte $" + to_hex(opcode);
+  return 1;
+}
+
+Debugger::Debugger(CPU *cpu, std::string path)
+    : cpu(cpu), path(std::move(path)) {}
+
+Debugger::~Debugger() { stop(); }
+
+void Debugger::start() {
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    throw std::runtime_error("Debugger socket path too long: " + path);
+  }
+  path.copy(addr.sun_path, path.size());
+
+  // Only replace a stale socket; never delete a regular file given by mistake.
+  struct stat info {};
+  if (::lstat(path.c_str(), &info) == 0) {
+    if (!S_ISSOCK(info.st_mode)) {
+      throw std::runtime_error("Debugger path exists and is not a socket: " +
+                               path);
+    }
+    ::unlink(path.c_str());
+  }
+
+  listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd < 0) {
+    throw std::runtime_error("Debugger socket failed: " + path);
+  }
+  if (::bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) <
+      0) {
+    release();
+    throw std::runtime_error("Debugger bind failed: " + path);
+  }
+  if (::lstat(path.c_str(), &info) == 0) {
+    socket_created = true;
+    socket_dev = info.st_dev;
+    socket_ino = info.st_ino;
+  }
+  if (::listen(listen_fd, 1) < 0) {
+    release();
+    throw std::runtime_error("Debugger listen failed: " + path);
+  }
+
+  // Non-blocking so a full pipe (a wake already pending) never stalls the
+  // CPU thread.
+  if (::pipe(wake_fd) < 0 || ::fcntl(wake_fd[0], F_SETFL, O_NONBLOCK) < 0 ||
+      ::fcntl(wake_fd[1], F_SETFL, O_NONBLOCK) < 0) {
+    release();
+    throw std::runtime_error("Debugger pipe failed");
+  }
+
+  cpu->debugger.store(this);
+  running = true;
+  server = std::thread(&Debugger::serve, this);
+}
+
+void Debugger::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!running) {
+      return;
+    }
+    running = false;
+    clear_breakpoints();
+    halt_requested = stepping = false;
+    halted = false;
+    update_events();
+  }
+  resumed.notify_all();
+  wake();
+  server.join();
+
+  // Detach, then wait for a CPU thread that already loaded the pointer (or
+  // is still unwinding from a park) to leave on_instruction.
+  cpu->debug_events.store(false);
+  cpu->debugger.store(nullptr);
+  resumed.notify_all();
+  while (cpu->debugger_calls.load() != 0) {
+    std::this_thread::yield();
+  }
+  release();
+}
+
+void Debugger::release() {
+  if (listen_fd >= 0) {
+    ::close(listen_fd);
+  }
+  for (int &fd : wake_fd) {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+  listen_fd = wake_fd[0] = wake_fd[1] = -1;
+
+  struct stat info {};
+  if (socket_created && ::lstat(path.c_str(), &info) == 0 &&
+      S_ISSOCK(info.st_mode) && info.st_dev == socket_dev &&
+      info.st_ino == socket_ino) {
+    ::unlink(path.c_str());
+  }
+  socket_created = false;
+}
+
+void Debugger::wake() {
+  while (::write(wake_fd[1], "w", 1) < 0 && errno == EINTR) {
+  }
+  // EAGAIN means the pipe is full, so a wake-up is already pending.
+}
+
+void Debugger::drain_wake() {
+  char drain[64];
+  for (;;) {
+    ssize_t n = ::read(wake_fd[0], drain, sizeof(drain));
+    if (n > 0) {
+      continue;
+    }
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    return; // empty (EAGAIN) or closed
+  }
+}
+
+void Debugger::clear_breakpoints() {
+  for (auto &breakpoint : breakpoints) {
+    breakpoint.store(0, std::memory_order_relaxed);
+  }
+  breakpoint_count = 0;
+}
+
+void Debugger::halt() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (running && !halted) {
+    halt_requested = true;
+    update_events();
+  }
+}
+
+void Debugger::update_events() {
+  control_pending.store(halt_requested || stepping, std::memory_order_release);
+  // Sequentially consistent, paired with CPU::executing: a CPU thread
+  // entering run() either sees the pending halt or is seen executing.
+  cpu->debug_events.store(halt_requested || stepping || breakpoint_count > 0);
+}
+
+void Debugger::on_instruction(CPU &cpu) {
+  // Fast path: a running CPU that misses every breakpoint never locks.
+  if (!control_pending.load(std::memory_order_acquire) &&
+      !breakpoints[cpu.PC].load(std::memory_order_relaxed)) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  if (!running || (!halt_requested && !stepping &&
+                   !breakpoints[cpu.PC].load(std::memory_order_relaxed))) {
+    return;
+  }
+  halt_requested = stepping = false;
+  halted = true;
+  // Parking on a halt the client already saw while the CPU was idle is not
+  // a new stop.
+  report_stop = !idle_stop;
+  idle_stop = false;
+  update_events();
+  parked.notify_all();
+  wake();
+  resumed.wait(lock, [this] { return !halted; });
+}
+
+void Debugger::resume(bool step) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stepping = step;
+    halt_requested = false;
+    idle_stop = false;
+    halted = false;
+    update_events();
+  }
+  resumed.notify_all();
+}
+
+void Debugger::serve() {
+  while (running) {
+    pollfd fds[2] = {{listen_fd, POLLIN, 0}, {wake_fd[0], POLLIN, 0}};
+    if (::poll(fds, 2, -1) < 0) {
+      continue;
+    }
+    if (fds[1].revents & POLLIN) {
+      drain_wake();
+    }
+    if (!(fds[0].revents & POLLIN) || !running) {
+      continue;
+    }
+    client_fd = ::accept(listen_fd, nullptr, nullptr);
+    if (client_fd < 0) {
+      continue;
+    }
+
+    // GDB expects the target to be stopped when it attaches.
+    halt();
+    session();
+
+    // Detach: drop breakpoints and let the CPU run freely again.
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      clear_breakpoints();
+      halt_requested = stepping = false;
+      halted = false;
+      report_stop = idle_stop = false;
+      update_events();
+    }
+    resumed.notify_all();
+    ::close(client_fd);
+    client_fd = -1;
+  }
+}
+
+void Debugger::session() {
+  std::string buffer;
+  attached = true;
+  while (running && attached) {
+    pollfd fds[2] = {{client_fd, POLLIN, 0}, {wake_fd[0], POLLIN, 0}};
+    if (::poll(fds, 2, -1) < 0) {
+      continue;
+    }
+
+    if (fds[1].revents & POLLIN) {
+      drain_wake();
+      bool report = false;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        report = halted && report_stop;
+        report_stop = false;
+      }
+      if (report) {
+        send_packet("S05");
+      }
+    }
+
+    if (!(fds[0].revents & (POLLIN | POLLHUP))) {
+      continue;
+    }
+    char chunk[1024];
+    ssize_t n = ::recv(client_fd, chunk, sizeof(chunk), 0);
+    if (n <= 0) {
+      return;
+    }
+    buffer.append(chunk, n);
+
+    while (!buffer.empty()) {
+      if (buffer[0] == '+' || buffer[0] == '-') {
+        buffer.erase(0, 1);
+      } else if (buffer[0] == '\x03') {
+        buffer.erase(0, 1);
+        halt();
+      } else if (buffer[0] == '$') {
+        size_t end = buffer.find('#');
+        if (end == std::string::npos || end + 2 >= buffer.size()) {
+          break; // wait for the rest of the packet
+        }
+        std::string packet = buffer.substr(1, end - 1);
+        buffer.erase(0, end + 3);
+        send_all(client_fd, "+");
+        try {
+          handle_packet(packet);
+        } catch (const std::exception &) {
+          send_packet("E02"); // malformed arguments
+        }
+      } else {
+        buffer.erase(0, 1);
+      }
+    }
+  }
+}
+
+void Debugger::send_packet(const std::string &payload) {
+  uint8_t checksum = 0;
+  for (unsigned char c : payload) {
+    checksum += c;
+  }
+  send_all(client_fd, "$" + payload + "#" + to_hex(checksum));
+}
+
+void Debugger::handle_packet(const std::string &packet) {
+  char command = packet.empty() ? '\0' : packet[0];
+  std::string args = packet.empty() ? "" : packet.substr(1);
+
+  // Register and memory access is only safe while the CPU thread is parked,
+  // or while it is outside CPU::run with a halt pending: it then parks on
+  // entry, which needs this lock, so the lock is held for the whole packet.
+  std::unique_lock<std::mutex> lock(mutex);
+  auto inspectable = [this] {
+    return halted || (halt_requested && !cpu->executing.load());
+  };
+  bool stopped = inspectable();
+
+  switch (command) {
+  case '?': {
+    // Wait for the halt issued on attach to land. A CPU that is not
+    // executing stays stopped on the pending halt instead.
+    parked.wait_for(lock, std::chrono::seconds(1),
+                    [this] { return halted || !cpu->executing.load(); });
+    idle_stop = !halted && inspectable();
+    report_stop = false;
+    send_packet("S05");
+  } break;
+  case 'g': {
+    if (!stopped) {
+      send_packet("E01");
+      break;
+    }
+    std::string out;
+    for (int i = 0; i < 6; i++) {
+      out += read_register(*cpu, i);
+    }
+    send_packet(out);
+  } break;
+  case 'G': {
+    if (!stopped || args.size() < 14) {
+      send_packet("E01");
+      break;
+    }
+    for (int i = 0; i < 5; i++) {
+      write_register(*cpu, i, args.substr(i * 2, 2));
+    }
+    write_register(*cpu, 5, args.substr(10, 4));
+    send_packet("OK");
+  } break;
+  case 'p': {
+    std::string value =
+        stopped ? read_register(*cpu, std::stoi(args, nullptr, 16)) : "";
+    send_packet(value.empty() ? "E01" : value);
+  } break;
+  case 'P': {
+    size_t eq = args.find('=');
+    bool ok = stopped && eq != std::string::npos &&
+              write_register(*cpu, std::stoi(args.substr(0, eq), nullptr, 16),
+                             args.substr(eq + 1));
+    send_packet(ok ? "OK" : "E01");
+  } break;
+  case 'm': {
+    size_t comma = args.find(',');
+    if (!stopped || comma == std::string::npos) {
+      send_packet("E01");
+      break;
+    }
+    uint16_t address = std::stoul(args.substr(0, comma), nullptr, 16);
+    size_t length = std::stoul(args.substr(comma + 1), nullptr, 16);
+    std::string out;
+    for (size_t i = 0; i < length && i < 0x800; i++) {
+      out += to_hex(cpu->read(address + i));
+    }
+    send_packet(out);
+  } break;
+  case 'M': {
+    size_t comma = args.find(',');
+    size_t colon = args.find(':');
+    if (!stopped || comma == std::string::npos ||
+        colon == std::string::npos) {
+      send_packet("E01");
+      break;
+    }
+    uint16_t address = std::stoul(args.substr(0, comma), nullptr, 16);
+    std::string bytes = from_hex(args.substr(colon + 1));
+    try {
+      for (size_t i = 0; i < bytes.size(); i++) {
+        cpu->write(address + i, static_cast<uint8_t>(bytes[i]));
+      }
+      send_packet("OK");
+    } catch (const std::runtime_error &) {
+      send_packet("E03");
+    }
+  } break;
+  case 'Z':
+  case 'z': {
+    // Software and hardware breakpoints share the PC bitmap.
+    if (args.size() < 3 || (args[0] != '0' && args[0] != '1')) {
+      send_packet("");
+      break;
+    }
+    uint16_t address = std::stoul(args.substr(2), nullptr, 16);
+    bool set = command == 'Z';
+    if (static_cast<bool>(breakpoints[address].load()) != set) {
+      breakpoints[address].store(set, std::memory_order_relaxed);
+      breakpoint_count += set ? 1 : -1;
+    }
+    update_events();
+    send_packet("OK");
+  } break;
+  case 'c':
+  case 's': {
+    if (!args.empty() && stopped) {
+      cpu->PC = std::stoul(args, nullptr, 16);
+    }
+    lock.unlock();
+    resume(command == 's');
+  } break;
+  case 'D':
+    send_packet("OK");
+    attached = false;
+    break;
+  case 'k':
+    attached = false;
+    break;
+  case 'H':
+    send_packet("OK");
+    break;
+  case 'q': {
+    if (packet.rfind("qSupported", 0) == 0) {
+      send_packet("PacketSize=4000");
+    } else if (packet == "qAttached") {
+      send_packet("1");
+    } else if (packet == "qC") {
+      send_packet("QC1");
+    } else if (packet == "qfThreadInfo") {
+      send_packet("m1");
+    } else if (packet == "qsThreadInfo") {
+      send_packet("l");
+    } else if (packet.rfind("qRcmd,", 0) == 0) {
+      // monitor disas [address] [count] | monitor regs
+      std::istringstream command_line(from_hex(packet.substr(6)));
+      std::string verb;
+      command_line >> verb;
+      std::ostringstream out;
+      if (!stopped) {
+        out << "cpu is running\n";
+      } else if (verb == "disas") {
+        unsigned address = cpu->PC, count = 8;
+        command_line >> std::hex >> address >> std::dec >> count;
+        count = std::min(count, 256u); // bounded like the m packet
+        for (unsigned i = 0; i < count; i++) {
+          std::string text;
+          int length = disassemble(*cpu, address, text);
+          out << (address == cpu->PC ? "=> " : "   ") << "$"
+              << to_hex(static_cast<uint8_t>(address >> 8))
+              << to_hex(static_cast<uint8_t>(address & 0xFF)) << "  " << text
+              << "\n";
+          address = (address + length) & 0xFFFF;
+        }
+      } else if (verb == "regs") {
+        out << "A=" << to_hex(cpu->AC) << " X=" << to_hex(cpu->IRX)
+            << " Y=" << to_hex(cpu->IRY) << " SP=" << to_hex(cpu->SP)
+            << " PS=" << to_hex(cpu->PS) << " PC="
+            << to_hex(static_cast<uint8_t>(cpu->PC >> 8))
+            << to_hex(static_cast<uint8_t>(cpu->PC & 0xFF)) << "\n";
+      } else {
+        out << "commands: disas [address] [count], regs\n";
+      }
+      send_packet("O" + to_hex(out.str()));
+      send_packet("OK");
+    } else {
+      send_packet("");
+    }
+  } break;
+  default:
+    send_packet("");
+    break;
+  }
+}
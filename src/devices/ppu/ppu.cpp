@@ -5,3 +5,7 @@ uint8_t Ppu::read(uint16_t address) { return data[address & 0x07FF]; }
 void Ppu::write(uint16_t address, uint8_t value) {
   data[address & 0x07FF] = value;
 }
+
+uint8_t *Ppu::state_data() { return data.data(); }
+
+std::size_t Ppu::state_size() const { return data.size(); }
@@ -5,3 +5,8 @@ uint8_t Ram::read(uint16_t address) { return data[address & 0x07FF]; }
 void Ram::write(uint16_t address, uint8_t value) {
   data[address & 0x07FF] = value;
 }
+
+uint8_t *Ram::state_data() { return data.data(); }
+
+// Only the mirrored 2 KB window is reachable through read/write.
+std::size_t Ram::state_size() const { return 0x0800; }
@@ -5,3 +5,7 @@ uint8_t Rom::read(uint16_t address) { return data[address & 0x07FF]; }
 void Rom::write(uint16_t address, uint8_t value) {
   data[address & 0x07FF] = value;
 }
+
+uint8_t *Rom::state_data() { return data.data(); }
+
+std::size_t Rom::state_size() const { return data.size(); }
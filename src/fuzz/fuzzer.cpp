@@ -0,0 +1,249 @@
+#include "fuzz/fuzzer.h"
+#include "bus/bus.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+// Collapse a hit count into an AFL-style bucket bit so loops that run a
+// few more times do not all count as new behaviour.
+uint8_t bucket(uint8_t hits) {
+  if (hits == 0) {
+    return 0;
+  }
+  if (hits <= 3) {
+    return 1 << (hits - 1);
+  }
+  if (hits <= 7) {
+    return 1 << 3;
+  }
+  if (hits <= 15) {
+    return 1 << 4;
+  }
+  if (hits <= 31) {
+    return 1 << 5;
+  }
+  if (hits <= 127) {
+    return 1 << 6;
+  }
+  return 1 << 7;
+}
+
+const uint8_t INTERESTING[] = {0x00, 0x01, 0x7F, 0x80, 0xFF, 0x10, 0x20, 0x40};
+
+} // namespace
+
+const char *outcome_name(Fuzzer::Outcome outcome) {
+  switch (outcome) {
+  case Fuzzer::Outcome::OK:
+    return "ok";
+  case Fuzzer::Outcome::UNKNOWN_OPCODE:
+    return "unknown opcode";
+  case Fuzzer::Outcome::UNMAPPED_VECTOR:
+    return "BRK to unmapped vector";
+  case Fuzzer::Outcome::UNMAPPED_WRITE:
+    return "unmapped write";
+  case Fuzzer::Outcome::TIMEOUT:
+    return "timeout";
+  }
+  return "?";
+}
+
+Fuzzer::Fuzzer(CPU *cpu, Bus *bus, uint16_t entry, uint16_t input_address,
+               uint16_t harness_address)
+    : cpu(cpu), bus(bus), entry(entry), input_address(input_address),
+      harness_address(harness_address) {}
+
+Fuzzer::~Fuzzer() {
+  if (cpu->coverage == trace.data()) {
+    cpu->coverage = nullptr;
+    cpu->coverage_edges = nullptr;
+    cpu->coverage_edge_count = 0;
+    cpu->strict = false;
+    cpu->stop_pc = -1;
+  }
+}
+
+void Fuzzer::prepare() {
+  uint16_t done = harness_address + 3;
+  cpu->load_program({CPU::JSR, static_cast<uint8_t>(entry & 0xFF),
+                     static_cast<uint8_t>(entry >> 8), CPU::JMP_ABSOLUTE,
+                     static_cast<uint8_t>(done & 0xFF),
+                     static_cast<uint8_t>(done >> 8)},
+                    harness_address);
+  cpu->PC = harness_address;
+  cpu->strict = true;
+  cpu->stop_pc = done;
+  cpu->coverage = trace.data();
+  cpu->coverage_edges = edges.data();
+  cpu->coverage_edge_count = 0;
+  snapshot.capture(*cpu, *bus);
+}
+
+void Fuzzer::add_seed(const std::vector<uint8_t> &input) {
+  Finding finding;
+  if (run_one(input, finding) == Outcome::OK) {
+    update_coverage(seen);
+  }
+  corpus.push_back(input);
+}
+
+Fuzzer::Outcome Fuzzer::run_one(const std::vector<uint8_t> &input,
+                                Finding &finding) {
+  snapshot.restore(*cpu, *bus);
+  clear_coverage();
+  executions++;
+
+  uint16_t done = harness_address + 3;
+  Outcome outcome = Outcome::TIMEOUT;
+  try {
+    size_t length = std::min(input.size(), max_input);
+    for (size_t i = 0; i < length; i++) {
+      cpu->write(input_address + i, input[i]);
+    }
+    cpu->AC = static_cast<uint8_t>(std::min<size_t>(length, 0xFF));
+
+    cpu->run(cycle_limit);
+    if (cpu->PC == done) {
+      outcome = Outcome::OK;
+    }
+    finding.pc = cpu->PC;
+  } catch (const CpuFault &fault) {
+    outcome = fault.kind == CpuFault::UNKNOWN_OPCODE ? Outcome::UNKNOWN_OPCODE
+                                                     : Outcome::UNMAPPED_VECTOR;
+    finding.pc = fault.address;
+    finding.detail = fault.what();
+  } catch (const std::runtime_error &error) {
+    // Bus::write is the only other thrower on the execution path.
+    outcome = Outcome::UNMAPPED_WRITE;
+    finding.pc = cpu->PC;
+    finding.detail = error.what();
+  }
+  finding.outcome = outcome;
+  finding.from = cpu->coverage_last_from;
+  return outcome;
+}
+
+bool Fuzzer::update_coverage(std::vector<uint8_t> &known) {
+  bool found = false;
+  for (size_t i = 0; i < cpu->coverage_edge_count; i++) {
+    uint16_t edge = edges[i];
+    uint8_t bits = bucket(trace[edge]);
+    if (bits & ~known[edge]) {
+      known[edge] |= bits;
+      found = true;
+    }
+  }
+  return found;
+}
+
+void Fuzzer::clear_coverage() {
+  for (size_t i = 0; i < cpu->coverage_edge_count; i++) {
+    trace[edges[i]] = 0;
+  }
+  cpu->coverage_edge_count = 0;
+  cpu->coverage_last_from = 0;
+}
+
+std::vector<uint8_t> Fuzzer::mutate(const std::vector<uint8_t> &input) {
+  std::vector<uint8_t> out = input;
+  int rounds = 1 << (rng() % 4);
+  for (int r = 0; r < rounds; r++) {
+    size_t size = out.size();
+    switch (rng() % 8) {
+    case 0: // flip a bit
+      if (size) {
+        out[rng() % size] ^= 1 << (rng() % 8);
+      }
+      break;
+    case 1: // random byte
+      if (size) {
+        out[rng() % size] = static_cast<uint8_t>(rng());
+      }
+      break;
+    case 2: // interesting value
+      if (size) {
+        out[rng() % size] = INTERESTING[rng() % sizeof(INTERESTING)];
+      }
+      break;
+    case 3: // small add/subtract
+      if (size) {
+        out[rng() % size] += static_cast<uint8_t>(rng() % 35) - 17;
+      }
+      break;
+    case 4: // insert a byte
+      if (size < max_input) {
+        out.insert(out.begin() + (size ? rng() % (size + 1) : 0),
+                   static_cast<uint8_t>(rng()));
+      }
+      break;
+    case 5: // delete a run
+      if (size > 1) {
+        size_t at = rng() % size;
+        size_t count = 1 + rng() % std::min<size_t>(size - at, 8);
+        out.erase(out.begin() + at, out.begin() + at + count);
+      }
+      break;
+    case 6: // duplicate a run within the input
+      if (size > 1 && size < max_input) {
+        size_t from = rng() % size;
+        size_t count = 1 + rng() % std::min<size_t>(size - from, 16);
+        std::vector<uint8_t> run(out.begin() + from,
+                                 out.begin() + from + count);
+        out.insert(out.begin() + rng() % (size + 1), run.begin(), run.end());
+      }
+      break;
+    case 7: // splice the tail of another corpus entry
+      if (corpus.size() > 1) {
+        const std::vector<uint8_t> &other = corpus[rng() % corpus.size()];
+        if (!other.empty()) {
+          size_t cut = size ? rng() % size : 0;
+          size_t from = rng() % other.size();
+          out.resize(cut);
+          out.insert(out.end(), other.begin() + from, other.end());
+        }
+      }
+      break;
+    }
+  }
+  if (out.size() > max_input) {
+    out.resize(max_input);
+  }
+  return out;
+}
+
+void Fuzzer::fuzz(uint64_t iterations) {
+  if (corpus.empty()) {
+    add_seed({});
+  }
+  for (uint64_t i = 0; i < iterations; i++) {
+    std::vector<uint8_t> input = mutate(corpus[rng() % corpus.size()]);
+    Finding finding;
+    Outcome outcome = run_one(input, finding);
+    if (outcome == Outcome::OK) {
+      if (update_coverage(seen)) {
+        corpus.push_back(std::move(input));
+      }
+      continue;
+    }
+
+    // A crash is identified by its outcome and the control transfer that
+    // led to it, so one bug hit from many inputs, including a wild jump
+    // landing on many different bad targets, is reported once. Hangs have
+    // no single faulting site; keep those that loop over new edges.
+    bool keep;
+    std::vector<Finding> &findings =
+        outcome == Outcome::TIMEOUT ? hangs : crashes;
+    if (outcome == Outcome::TIMEOUT) {
+      keep = update_coverage(hang_seen);
+    } else {
+      keep = crash_sites.insert({outcome, finding.from}).second;
+    }
+    if (keep && findings.size() < max_findings) {
+      finding.input = std::move(input);
+      findings.push_back(std::move(finding));
+    }
+  }
+}
@@ -1,14 +1,51 @@
 #include "bus/bus.h"
 #include "cpu/cpu.h"
+#include "debugger/debugger.h"
 #include "devices/ppu.h"
 #include "devices/ram.h"
 #include "devices/rom.h"
+#include "fuzz/fuzzer.h"
+#include "state/savestate.h"
+#include "timing/throttle.h"
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
-int main() {
+int main(int argc, char *argv[]) {
+  // --debug <socket>: serve the GDB remote protocol on a Unix-domain socket.
+  // --debug-wait: halt before the first instruction until a client resumes.
+  // --clock <hz>: pace execution in real time at the given clock rate.
+  // --load-state <file>: resume from a save state instead of a fresh boot.
+  // --save-state <file>: checkpoint the machine after execution.
+  // --fuzz <iterations>: fuzz the demo dispatcher with inputs at 0x0300.
+  std::string debug_socket;
+  std::string load_path;
+  std::string save_path;
+  bool debug_wait = false;
+  double clock_hz = 0.0;
+  uint64_t fuzz_iterations = 0;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--debug" && i + 1 < argc) {
+      debug_socket = argv[++i];
+    } else if (arg == "--debug-wait") {
+      debug_wait = true;
+    } else if (arg == "--clock" && i + 1 < argc) {
+      clock_hz = std::stod(argv[++i]);
+    } else if (arg == "--load-state" && i + 1 < argc) {
+      load_path = argv[++i];
+    } else if (arg == "--save-state" && i + 1 < argc) {
+      save_path = argv[++i];
+    } else if (arg == "--fuzz" && i + 1 < argc) {
+      fuzz_iterations = std::stoull(argv[++i]);
+    }
+  }
+
   Bus bus{};
   Ram ram{};
   bus.attach(0x0000, 0x0800, &ram);
@@ -19,6 +56,21 @@ int main() {
 
   CPU cpu{&bus};
 
+  std::unique_ptr<Debugger> debugger;
+  if (!debug_socket.empty()) {
+    debugger = std::make_unique<Debugger>(&cpu, debug_socket);
+    try {
+      debugger->start();
+    } catch (const std::runtime_error &error) {
+      std::cerr << error.what() << "\n";
+      return 1;
+    }
+    if (debug_wait) {
+      debugger->halt();
+    }
+    std::cout << "Debugger listening on " << debug_socket << "\n";
+  }
+
   uint16_t output_addr = 0x0200;
   std::string input = "Hello world this is my first cpu assembled script.";
 
@@ -53,6 +105,46 @@ int main() {
 
   cpu.load_program(main_program, main_start);
 
+  if (fuzz_iterations) {
+    // Fuzz target: a dispatcher that jumps to $0500 + input length. Most
+    // table slots are RTS; a few handlers use the input or misbehave.
+    uint16_t dispatch = 0x0400;
+    cpu.load_program({0x85, 0xF0,        // STA $F0 (length)
+                      0xA9, 0x05,        // LDA #$05
+                      0x85, 0xF1,        // STA $F1
+                      0x6C, 0xF0, 0x00}, // JMP ($00F0)
+                     dispatch);
+    cpu.load_program(std::vector<uint8_t>(0x100, 0x60), 0x0500); // RTS
+    cpu.load_program({0x6C, 0x00, 0x03}, 0x0504); // JMP ($0300): input
+    cpu.load_program({0x8D, 0x00, 0x40}, 0x0510); // STA $4000: unmapped
+    cpu.load_program({0x4C, 0x20, 0x05}, 0x0520); // JMP $0520: spin
+
+    Fuzzer fuzzer{&cpu, &bus, dispatch, 0x0300, 0x07F0};
+    fuzzer.prepare();
+    auto start = std::chrono::steady_clock::now();
+    fuzzer.fuzz(fuzz_iterations);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << fuzzer.executions << " executions ("
+              << fuzzer.executions / elapsed.count() << "/s), corpus "
+              << fuzzer.corpus.size() << ", crashes " << fuzzer.crashes.size()
+              << ", hangs " << fuzzer.hangs.size() << "\n";
+    for (auto &finding : fuzzer.crashes) {
+      std::cout << outcome_name(finding.outcome) << " at " << std::hex
+                << finding.pc << std::dec << ": " << finding.detail << "\n";
+    }
+    return 0;
+  }
+
+  if (!load_path.empty()) {
+    try {
+      load_state_file(load_path, cpu, bus);
+    } catch (const std::runtime_error &error) {
+      std::cerr << error.what() << "\n";
+      return 1;
+    }
+  }
+
   for (int i = 0; i < size(ram.data) / 25; i++) {
     std::cout << std::hex << +ram.data[i] << " ";
   };
@@ -60,7 +152,31 @@ int main() {
   std::cout << std::hex << +cpu.AC << " " << +cpu.PC << " " << +cpu.SP << " "
             << +cpu.IRX << " " << +cpu.IRY << " " << +cpu.PS << std::dec
             << std::endl;
-  cpu.execute(main_program.size() * 6); // rough estimate
+  int budget = main_program.size() * 6; // rough estimate
+  if (clock_hz > 0.0) {
+    Throttle throttle{&cpu, clock_hz};
+    int slices = 0;
+    double min_headroom = 1.0;
+    while (budget > 0) {
+      Throttle::SliceStats stats = throttle.run_slice(budget);
+      budget -= stats.cycles;
+      min_headroom = std::min(min_headroom, stats.headroom);
+      slices++;
+    }
+    std::cout << "Real-time: " << slices << " slices at " << clock_hz
+              << " Hz, min headroom " << min_headroom * 100.0 << "%\n";
+  } else {
+    cpu.execute(budget);
+  }
+
+  if (!save_path.empty()) {
+    try {
+      save_state_file(save_path, cpu, bus);
+    } catch (const std::runtime_error &error) {
+      std::cerr << error.what() << "\n";
+      return 1;
+    }
+  }
   std::cout << std::hex << +cpu.AC << " " << +cpu.PC << " " << +cpu.SP << " "
             << +cpu.IRX << " " << +cpu.IRY << " " << +cpu.PS << std::dec
             << std::endl;
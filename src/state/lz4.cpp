@@ -0,0 +1,147 @@
+#include "state/lz4.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+constexpr std::size_t MIN_MATCH = 4;
+// The format requires the last 5 bytes to be literals and the last match
+// to start at least 12 bytes before the end of the block.
+constexpr std::size_t LAST_LITERALS = 5;
+constexpr std::size_t MF_LIMIT = 12;
+constexpr int HASH_BITS = 12;
+
+uint32_t load32(const uint8_t *p) {
+  uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+uint32_t hash(uint32_t sequence) {
+  return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+void put_length(std::vector<uint8_t> &out, std::size_t length) {
+  while (length >= 255) {
+    out.push_back(255);
+    length -= 255;
+  }
+  out.push_back(static_cast<uint8_t>(length));
+}
+
+void emit(std::vector<uint8_t> &out, const uint8_t *literals,
+          std::size_t literal_length, std::size_t offset,
+          std::size_t match_length) {
+  std::size_t match_code = match_length ? match_length - MIN_MATCH : 0;
+  uint8_t token = (literal_length >= 15 ? 15 : literal_length) << 4;
+  token |= match_code >= 15 ? 15 : match_code;
+  out.push_back(token);
+  if (literal_length >= 15) {
+    put_length(out, literal_length - 15);
+  }
+  out.insert(out.end(), literals, literals + literal_length);
+  if (!match_length) {
+    return; // final literal-only sequence
+  }
+  out.push_back(offset & 0xFF);
+  out.push_back(offset >> 8);
+  if (match_code >= 15) {
+    put_length(out, match_code - 15);
+  }
+}
+
+std::size_t get_length(const uint8_t *src, std::size_t src_size,
+                       std::size_t &ip) {
+  std::size_t length = 0;
+  uint8_t byte;
+  do {
+    if (ip >= src_size) {
+      throw std::runtime_error("LZ4: truncated length");
+    }
+    byte = src[ip++];
+    length += byte;
+  } while (byte == 255);
+  return length;
+}
+
+} // namespace
+
+std::vector<uint8_t> lz4_compress(const uint8_t *src, std::size_t size) {
+  std::vector<uint8_t> out;
+  out.reserve(size / 4 + 16);
+  std::vector<int32_t> table(1 << HASH_BITS, -1);
+
+  std::size_t anchor = 0;
+  std::size_t ip = 0;
+  if (size > MF_LIMIT) {
+    std::size_t match_limit = size - LAST_LITERALS;
+    while (ip + MF_LIMIT <= size) {
+      uint32_t sequence = load32(src + ip);
+      uint32_t h = hash(sequence);
+      int32_t candidate = table[h];
+      table[h] = static_cast<int32_t>(ip);
+      if (candidate < 0 || ip - candidate > 0xFFFF ||
+          load32(src + candidate) != sequence) {
+        ip++;
+        continue;
+      }
+      std::size_t length = MIN_MATCH;
+      while (ip + length < match_limit &&
+             src[candidate + length] == src[ip + length]) {
+        length++;
+      }
+      emit(out, src + anchor, ip - anchor, ip - candidate, length);
+      ip += length;
+      anchor = ip;
+    }
+  }
+  emit(out, src + anchor, size - anchor, 0, 0);
+  return out;
+}
+
+void lz4_decompress(const uint8_t *src, std::size_t src_size, uint8_t *dst,
+                    std::size_t dst_size) {
+  std::size_t ip = 0;
+  std::size_t op = 0;
+  while (ip < src_size) {
+    uint8_t token = src[ip++];
+
+    std::size_t literal_length = token >> 4;
+    if (literal_length == 15) {
+      literal_length += get_length(src, src_size, ip);
+    }
+    if (literal_length > src_size - ip || literal_length > dst_size - op) {
+      throw std::runtime_error("LZ4: literal run out of bounds");
+    }
+    if (literal_length) {
+      std::memcpy(dst + op, src + ip, literal_length);
+    }
+    ip += literal_length;
+    op += literal_length;
+    if (ip == src_size) {
+      break; // final sequence carries no match
+    }
+
+    if (src_size - ip < 2) {
+      throw std::runtime_error("LZ4: truncated offset");
+    }
+    std::size_t offset = src[ip] | (src[ip + 1] << 8);
+    ip += 2;
+    std::size_t match_length = token & 0x0F;
+    if (match_length == 15) {
+      match_length += get_length(src, src_size, ip);
+    }
+    match_length += MIN_MATCH;
+    if (offset == 0 || offset > op || match_length > dst_size - op) {
+      throw std::runtime_error("LZ4: match out of bounds");
+    }
+    // Byte-wise copy: matches may overlap their own output.
+    for (std::size_t i = 0; i < match_length; i++, op++) {
+      dst[op] = dst[op - offset];
+    }
+  }
+  if (op != dst_size) {
+    throw std::runtime_error("LZ4: decoded size mismatch");
+  }
+}
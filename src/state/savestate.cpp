@@ -0,0 +1,351 @@
+#include "state/savestate.h"
+#include "bus/bus.h"
+#include "cpu/cpu.h"
+#include "state/lz4.h"
+
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char MAGIC[4] = {'M', '6', '5', 'S'};
+constexpr uint8_t ENCODING_RAW = 0;
+constexpr uint8_t ENCODING_LZ4 = 1;
+// Magic, version and device count.
+constexpr std::size_t HEADER_SIZE = 8;
+constexpr std::size_t TRAILER_SIZE = 4;
+
+// CRC-32 (IEEE 802.3, reflected), one table lookup per byte.
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, std::size_t size) {
+  static const auto table = [] {
+    std::array<uint32_t, 256> entries{};
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t value = i;
+      for (int bit = 0; bit < 8; bit++) {
+        value = (value >> 1) ^ (value & 1 ? 0xEDB88320u : 0);
+      }
+      entries[i] = value;
+    }
+    return entries;
+  }();
+  crc = ~crc;
+  for (std::size_t i = 0; i < size; i++) {
+    crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+struct StateWriter {
+  std::ostream &out;
+  uint32_t crc = 0;
+
+  void u8(uint8_t value) { bytes(&value, 1); }
+  void u16(uint16_t value) {
+    u8(value & 0xFF);
+    u8(value >> 8);
+  }
+  void u32(uint32_t value) {
+    u16(value & 0xFFFF);
+    u16(value >> 16);
+  }
+  void u64(uint64_t value) {
+    u32(value & 0xFFFFFFFF);
+    u32(value >> 32);
+  }
+  void bytes(const void *data, std::size_t size) {
+    crc = crc32_update(crc, static_cast<const uint8_t *>(data), size);
+    out.write(static_cast<const char *>(data), size);
+  }
+};
+
+// Write all of data to fd, retrying short writes and EINTR.
+bool write_all(int fd, const char *data, std::size_t size) {
+  while (size) {
+    ssize_t n = ::write(fd, data, size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+// Flush a rename in path's directory to disk.
+bool sync_directory(const std::string &path) {
+  std::size_t slash = path.rfind('/');
+  std::string dir = slash == std::string::npos ? "."
+                    : slash == 0               ? "/"
+                                               : path.substr(0, slash);
+  int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = ::fsync(fd) == 0;
+  ::close(fd);
+  return ok;
+}
+
+struct StateReader {
+  const uint8_t *data;
+  std::size_t size;
+  std::size_t pos = 0;
+
+  const uint8_t *take(std::size_t count) {
+    if (count > size - pos) {
+      throw std::runtime_error("Save state truncated");
+    }
+    const uint8_t *p = data + pos;
+    pos += count;
+    return p;
+  }
+  uint8_t u8() { return *take(1); }
+  uint16_t u16() {
+    uint16_t low = u8();
+    return low | (static_cast<uint16_t>(u8()) << 8);
+  }
+  uint32_t u32() {
+    uint32_t low = u16();
+    return low | (static_cast<uint32_t>(u16()) << 16);
+  }
+  uint64_t u64() {
+    uint64_t low = u32();
+    return low | (static_cast<uint64_t>(u32()) << 32);
+  }
+};
+
+} // namespace
+
+void save_state(std::ostream &out, CPU &cpu, Bus &bus, bool compress) {
+  StateWriter writer{out};
+  writer.bytes(MAGIC, sizeof(MAGIC));
+  writer.u16(SAVE_STATE_VERSION);
+  writer.u16(static_cast<uint16_t>(bus.devices.size()));
+
+  writer.u8(cpu.AC);
+  writer.u8(cpu.IRX);
+  writer.u8(cpu.IRY);
+  writer.u8(cpu.SP);
+  writer.u8(cpu.PS);
+  writer.u16(cpu.PC);
+  writer.u64(cpu.total_cycles);
+
+  for (auto &map : bus.devices) {
+    const uint8_t *raw = map.device->state_data();
+    std::size_t raw_size = map.device->state_size();
+    writer.u16(map.base);
+    writer.u16(map.size);
+    writer.u32(static_cast<uint32_t>(raw_size));
+
+    std::vector<uint8_t> packed;
+    if (compress && raw_size) {
+      packed = lz4_compress(raw, raw_size);
+    }
+    if (!packed.empty() && packed.size() < raw_size) {
+      writer.u32(static_cast<uint32_t>(packed.size()));
+      writer.u8(ENCODING_LZ4);
+      writer.bytes(packed.data(), packed.size());
+    } else {
+      writer.u32(static_cast<uint32_t>(raw_size));
+      writer.u8(ENCODING_RAW);
+      writer.bytes(raw, raw_size);
+    }
+  }
+  uint32_t crc = writer.crc;
+  writer.u32(crc);
+  if (!out) {
+    throw std::runtime_error("Save state write failed");
+  }
+}
+
+void save_state_file(const std::string &path, CPU &cpu, Bus &bus,
+                     bool compress) {
+  std::ostringstream buffer;
+  save_state(buffer, cpu, bus, compress);
+  std::string data = buffer.str();
+
+  // Write a uniquely named file beside the target, sync it and rename it
+  // over the target, then sync the directory: an interrupted save or a
+  // power loss leaves either the old or the new checkpoint, and concurrent
+  // savers never share a temporary file.
+  std::string temp = path + ".XXXXXX";
+  int fd = ::mkstemp(&temp[0]);
+  if (fd < 0) {
+    throw std::runtime_error("Cannot open save state for writing: " + path);
+  }
+  bool written = ::fchmod(fd, 0644) == 0 &&
+                 write_all(fd, data.data(), data.size()) && ::fsync(fd) == 0;
+  if (::close(fd) != 0 || !written) {
+    ::unlink(temp.c_str());
+    throw std::runtime_error("Save state write failed: " + path);
+  }
+  if (std::rename(temp.c_str(), path.c_str()) != 0) {
+    ::unlink(temp.c_str());
+    throw std::runtime_error("Cannot replace save state: " + path);
+  }
+  if (!sync_directory(path)) {
+    throw std::runtime_error("Cannot sync save state directory: " + path);
+  }
+}
+
+void load_state(const uint8_t *data, std::size_t size, CPU &cpu, Bus &bus) {
+  StateReader reader{data, size};
+  if (std::memcmp(reader.take(sizeof(MAGIC)), MAGIC, sizeof(MAGIC)) != 0) {
+    throw std::runtime_error("Not a save state");
+  }
+  uint16_t version = reader.u16();
+  if (version != SAVE_STATE_VERSION) {
+    throw std::runtime_error("Unsupported save state version: " +
+                             std::to_string(version));
+  }
+  if (size < HEADER_SIZE + TRAILER_SIZE) {
+    throw std::runtime_error("Save state truncated");
+  }
+  StateReader trailer{data + size - TRAILER_SIZE, TRAILER_SIZE};
+  if (trailer.u32() != crc32_update(0, data, size - TRAILER_SIZE)) {
+    throw std::runtime_error("Save state checksum mismatch");
+  }
+  reader.size = size - TRAILER_SIZE;
+  if (reader.u16() != bus.devices.size()) {
+    throw std::runtime_error("Save state device count does not match bus");
+  }
+
+  uint8_t ac = reader.u8();
+  uint8_t irx = reader.u8();
+  uint8_t iry = reader.u8();
+  uint8_t sp = reader.u8();
+  uint8_t ps = reader.u8();
+  uint16_t pc = reader.u16();
+  uint64_t total_cycles = reader.u64();
+
+  // Validate every section header before touching the machine.
+  struct Section {
+    const uint8_t *stored;
+    uint32_t raw_size;
+    uint32_t stored_size;
+    uint8_t encoding;
+  };
+  std::vector<Section> sections;
+  for (auto &map : bus.devices) {
+    uint16_t base = reader.u16();
+    uint16_t mapped_size = reader.u16();
+    uint32_t raw_size = reader.u32();
+    uint32_t stored_size = reader.u32();
+    uint8_t encoding = reader.u8();
+    if (base != map.base || mapped_size != map.size ||
+        raw_size != map.device->state_size()) {
+      throw std::runtime_error("Save state device at " + std::to_string(base) +
+                               " does not match bus");
+    }
+    if (encoding == ENCODING_RAW && stored_size != raw_size) {
+      throw std::runtime_error("Save state raw section at " +
+                               std::to_string(base) + " has wrong length");
+    }
+    if (encoding != ENCODING_RAW && encoding != ENCODING_LZ4) {
+      throw std::runtime_error("Unknown save state encoding: " +
+                               std::to_string(encoding));
+    }
+    sections.push_back(
+        {reader.take(stored_size), raw_size, stored_size, encoding});
+  }
+  if (reader.pos != reader.size) {
+    throw std::runtime_error("Save state has trailing data");
+  }
+
+  // Decode compressed sections into scratch so corrupt data still leaves
+  // the machine untouched; raw sections are copied straight from the input.
+  std::vector<std::vector<uint8_t>> decoded(sections.size());
+  for (size_t i = 0; i < sections.size(); i++) {
+    if (sections[i].encoding == ENCODING_LZ4) {
+      decoded[i].resize(sections[i].raw_size);
+      lz4_decompress(sections[i].stored, sections[i].stored_size,
+                     decoded[i].data(), decoded[i].size());
+    }
+  }
+
+  for (size_t i = 0; i < sections.size(); i++) {
+    Device *device = bus.devices[i].device;
+    const uint8_t *source = sections[i].encoding == ENCODING_LZ4
+                                ? decoded[i].data()
+                                : sections[i].stored;
+    if (device->state_size()) {
+      std::memcpy(device->state_data(), source, device->state_size());
+    }
+  }
+  cpu.AC = ac;
+  cpu.IRX = irx;
+  cpu.IRY = iry;
+  cpu.SP = sp;
+  cpu.PS = ps;
+  cpu.PC = pc;
+  cpu.total_cycles = total_cycles;
+}
+
+void load_state_file(const std::string &path, CPU &cpu, Bus &bus) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Cannot open save state: " + path);
+  }
+  struct stat info {};
+  if (::fstat(fd, &info) < 0 || info.st_size == 0) {
+    ::close(fd);
+    throw std::runtime_error("Cannot read save state: " + path);
+  }
+  std::size_t size = static_cast<std::size_t>(info.st_size);
+  void *mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    throw std::runtime_error("Cannot map save state: " + path);
+  }
+
+  try {
+    load_state(static_cast<const uint8_t *>(mapping), size, cpu, bus);
+  } catch (...) {
+    ::munmap(mapping, size);
+    throw;
+  }
+  ::munmap(mapping, size);
+}
+
+void Snapshot::capture(CPU &cpu, Bus &bus) {
+  AC = cpu.AC;
+  IRX = cpu.IRX;
+  IRY = cpu.IRY;
+  SP = cpu.SP;
+  PS = cpu.PS;
+  PC = cpu.PC;
+  total_cycles = cpu.total_cycles;
+  devices.clear();
+  for (auto &map : bus.devices) {
+    const uint8_t *raw = map.device->state_data();
+    devices.emplace_back(raw, raw + map.device->state_size());
+  }
+}
+
+void Snapshot::restore(CPU &cpu, Bus &bus) const {
+  cpu.AC = AC;
+  cpu.IRX = IRX;
+  cpu.IRY = IRY;
+  cpu.SP = SP;
+  cpu.PS = PS;
+  cpu.PC = PC;
+  cpu.total_cycles = total_cycles;
+  for (size_t i = 0; i < devices.size(); i++) {
+    if (!devices[i].empty()) {
+      std::memcpy(bus.devices[i].device->state_data(), devices[i].data(),
+                  devices[i].size());
+    }
+  }
+}
@@ -0,0 +1,50 @@
+#include "timing/throttle.h"
+#include "cpu/cpu.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+void Throttle::reset() {
+  started = false;
+  fraction = 0.0;
+  debt = 0;
+}
+
+Throttle::SliceStats Throttle::run_slice(int max_cycles) {
+  SliceStats stats;
+  auto period = std::chrono::duration_cast<clock::duration>(
+      std::chrono::duration<double>(1.0 / frame_hz));
+  stats.period = period;
+
+  clock::time_point start = clock::now();
+  if (!started) {
+    deadline = start;
+    started = true;
+  }
+
+  // Whole cycles for this frame; the remainder rolls into the next one.
+  fraction += clock_hz / frame_hz;
+  int budget = static_cast<int>(std::floor(fraction));
+  fraction -= budget;
+  budget = std::min(budget, max_cycles);
+
+  // Pay back any overrun from the previous slice's last instruction.
+  int requested = budget + debt;
+  debt = cpu->run(requested);
+  stats.cycles = requested - debt;
+
+  clock::time_point now = clock::now();
+  stats.busy = now - start;
+  stats.headroom = 1.0 - static_cast<double>(stats.busy.count()) /
+                             static_cast<double>(stats.period.count());
+
+  deadline += period;
+  if (now > deadline + max_lag) {
+    deadline = now;
+    stats.resynced = true;
+  } else {
+    std::this_thread::sleep_until(deadline);
+  }
+  return stats;
+}